@@ -0,0 +1,47 @@
+#ifndef COBS_H_
+#define COBS_H_
+#include <stdint.h>
+#include <stddef.h>
+
+// Consistent Overhead Byte Stuffing. The encoded frame contains no zero bytes, so a zero
+// can mark the end of each frame. Shared by the firmware and the host-side decoder.
+
+inline size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out) {
+  // Encode 'length' bytes into 'out', which must hold length + length / 254 + 1 bytes.
+  // Returns the encoded length, not including the zero delimiter.
+  size_t codeIndex = 0, outIndex = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (in[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = outIndex++;
+      code = 1;
+    } else {
+      out[outIndex++] = in[i];
+      if (++code == 0xFF) {
+        out[codeIndex] = code;
+        codeIndex = outIndex++;
+        code = 1;
+      }
+    }
+  }
+  out[codeIndex] = code;
+  return outIndex;
+}
+
+inline size_t cobsDecode(const uint8_t *in, size_t length, uint8_t *out) {
+  // Decode a frame without its zero delimiter. Returns the decoded length, or 0 if the frame is corrupt.
+  size_t i = 0, outIndex = 0;
+  while (i < length) {
+    uint8_t code = in[i++];
+    if (code == 0) { return 0; }
+    for (uint8_t j = 1; j < code; j++) {
+      if (i >= length || in[i] == 0) { return 0; }
+      out[outIndex++] = in[i++];
+    }
+    if (code != 0xFF && i < length) { out[outIndex++] = 0; }
+  }
+  return outIndex;
+}
+
+#endif
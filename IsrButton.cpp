@@ -0,0 +1,117 @@
+// Buttons sampled from a timer interrupt. Edges are timestamped and classified as clicks
+// or long presses in the interrupt, and the loop only runs the callbacks for queued events.
+// The button pins have no pin-change interrupts on the ATmega2560, so they are sampled on
+// the Timer0 compare interrupt, which runs once per millisecond alongside millis().
+
+#include <IsrButton.h>
+
+const unsigned long DebounceMillis = 50;  // Edges must be stable this long to count
+const unsigned long PressMillis = 800;    // Held this long, a press becomes a long press
+
+const uint8_t MaxButtons = 8;
+static IsrButton *buttons[MaxButtons];
+static uint8_t numberOfButtons = 0;
+
+enum buttonEvents { Click, LongPressStart, LongPressStop };
+struct ButtonEvent {
+  uint8_t button;
+  uint8_t event;
+};
+const uint8_t EventQueueSize = 16; // Must be a power of two
+static ButtonEvent eventQueue[EventQueueSize];
+static volatile uint8_t eventHead = 0; // Written only by the interrupt
+static volatile uint8_t eventTail = 0; // Written only by dispatch()
+
+static void postEvent(uint8_t button, uint8_t event) {
+  // Queue an event for the loop. If the queue is full, the event is dropped.
+  uint8_t next = (eventHead + 1) & (EventQueueSize - 1);
+  if (next == eventTail) { return; }
+  eventQueue[eventHead].button = button;
+  eventQueue[eventHead].event = event;
+  eventHead = next;
+}
+
+ISR(TIMER0_COMPA_vect) {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < numberOfButtons; i++) {
+    buttons[i]->sample(now);
+  }
+}
+
+IsrButton::IsrButton(uint8_t pin) {
+  this->pin = pin;
+  clickFunc = longPressStartFunc = longPressStopFunc = NULL;
+  lastRaw = isDown = isLong = false;
+  changedAt = pressedAt = 0;
+  index = numberOfButtons;
+  if (numberOfButtons < MaxButtons) { buttons[numberOfButtons++] = this; }
+}
+
+void IsrButton::attachClick(buttonCallback func, void *param) {
+  clickFunc = func;
+  clickParam = param;
+}
+
+void IsrButton::attachLongPressStart(buttonCallback func, void *param) {
+  longPressStartFunc = func;
+  longPressStartParam = param;
+}
+
+void IsrButton::attachLongPressStop(buttonCallback func, void *param) {
+  longPressStopFunc = func;
+  longPressStopParam = param;
+}
+
+void IsrButton::sample(unsigned long now) {
+  // Called from the timer interrupt. Timestamp raw edges, debounce them, and classify
+  // the press from the edge times so the result does not depend on the loop period.
+  bool raw = !(*inputRegister & bitMask);
+  if (raw != lastRaw) {
+    lastRaw = raw;
+    changedAt = now;
+  } else if (raw != isDown && now - changedAt >= DebounceMillis) {
+    isDown = raw;
+    if (isDown) {
+      pressedAt = changedAt;
+      isLong = false;
+    } else {
+      postEvent(index, isLong ? LongPressStop : Click);
+    }
+  }
+  if (isDown && !isLong && now - pressedAt >= PressMillis) {
+    isLong = true;
+    postEvent(index, LongPressStart);
+  }
+}
+
+void IsrButton::begin() {
+  // Set up the pins and start sampling on the Timer0 compare interrupt.
+  for (uint8_t i = 0; i < numberOfButtons; i++) {
+    IsrButton *button = buttons[i];
+    pinMode(button->pin, INPUT_PULLUP);
+    button->inputRegister = portInputRegister(digitalPinToPort(button->pin));
+    button->bitMask = digitalPinToBitMask(button->pin);
+  }
+  OCR0A = 0x80;
+  TIMSK0 |= _BV(OCIE0A);
+}
+
+void IsrButton::dispatch() {
+  // Run the callbacks for any queued events. When no button has changed this is a single compare.
+  while (eventTail != eventHead) {
+    ButtonEvent e = eventQueue[eventTail];
+    eventTail = (eventTail + 1) & (EventQueueSize - 1);
+    IsrButton *button = buttons[e.button];
+    switch (e.event) {
+      case Click:
+        if (button->clickFunc) { button->clickFunc(button->clickParam); }
+        break;
+      case LongPressStart:
+        if (button->longPressStartFunc) { button->longPressStartFunc(button->longPressStartParam); }
+        break;
+      case LongPressStop:
+        if (button->longPressStopFunc) { button->longPressStopFunc(button->longPressStopParam); }
+        break;
+    }
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef ISRBUTTON_H_
+#define ISRBUTTON_H_
+#include <Arduino.h>
+
+typedef void (*buttonCallback)(void *);
+
+class IsrButton {
+    volatile uint8_t *inputRegister;
+    uint8_t bitMask;
+    uint8_t pin;
+    uint8_t index;           // Position in the table of buttons sampled by the timer interrupt
+    bool lastRaw;            // Last sampled pin state, true if pressed
+    bool isDown;             // Debounced state
+    bool isLong;             // True once the long press has started
+    unsigned long changedAt; // Time of the last raw edge
+    unsigned long pressedAt; // Time of the edge that started the current press
+    buttonCallback clickFunc, longPressStartFunc, longPressStopFunc;
+    void *clickParam, *longPressStartParam, *longPressStopParam;
+  public:
+    IsrButton(uint8_t pin); // Active low, with the internal pullup
+    void attachClick(buttonCallback func, void *param);
+    void attachLongPressStart(buttonCallback func, void *param);
+    void attachLongPressStop(buttonCallback func, void *param);
+    void sample(unsigned long now);
+    static void begin();
+    static void dispatch();
+};
+
+#endif
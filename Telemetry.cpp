@@ -0,0 +1,75 @@
+// Binary telemetry records over a serial port, framed with COBS. A full record is sent
+// at a fixed period, and a delta record whenever a field changes in between. I2C
+// statistics are sent once a second.
+// Records are only queued when they fit in the serial transmit buffer, which is drained
+// by the UART interrupt, so update() never blocks the loop.
+
+#include <Telemetry.h>
+#include <Cobs.h>
+
+const unsigned long StatsPeriod = 1000;
+
+void Telemetry::init(HardwareSerial &port, unsigned long baud, unsigned long periodMillis) {
+  this->port = &port;
+  period = periodMillis;
+  sequence = 0;
+  lastFull = millis() - period; // Send a full record on the first update
+  lastStats = millis();
+  port.begin(baud);
+}
+
+void Telemetry::update(const int16_t *fields) {
+  // Send a full record if one is due, otherwise a delta of the fields that changed.
+  // If there is no room in the transmit buffer, nothing is sent and the changes are kept for later.
+  if (millis() - lastFull >= period) {
+    if (send(FullRecord, fields, NumberOfTelemetryFields, 0xFFFF)) {
+      lastFull = millis();
+      memcpy(sent, fields, sizeof(sent));
+    }
+    return;
+  }
+  uint16_t mask = 0;
+  for (uint8_t i = 0; i < NumberOfTelemetryFields; i++) {
+    if (fields[i] != sent[i]) { mask |= 1 << i; }
+  }
+  if (mask && send(DeltaRecord, fields, NumberOfTelemetryFields, mask)) {
+    memcpy(sent, fields, sizeof(sent));
+  }
+}
+
+void Telemetry::updateStats(const uint16_t *stats) {
+  // Send the I2C statistics if a stats record is due.
+  if (millis() - lastStats < StatsPeriod) { return; }
+  if (send(StatsRecord, (const int16_t *)stats, NumberOfI2cStats, 0xFFFF)) {
+    lastStats = millis();
+  }
+}
+
+bool Telemetry::send(uint8_t type, const int16_t *values, uint8_t count, uint16_t mask) {
+  // Build, frame and queue one record. Returns false if it does not fit in the transmit buffer.
+  uint8_t record[MaxTelemetryRecordSize];
+  uint8_t length = 0;
+  record[length++] = type;
+  record[length++] = sequence;
+  if (type == DeltaRecord) {
+    record[length++] = mask & 0xFF;
+    record[length++] = mask >> 8;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if (mask & (1 << i)) {
+      record[length++] = values[i] & 0xFF;
+      record[length++] = uint16_t(values[i]) >> 8;
+    }
+  }
+  uint8_t sum = 0;
+  for (uint8_t i = 0; i < length; i++) { sum += record[i]; }
+  record[length++] = -sum;
+
+  uint8_t frame[MaxTelemetryRecordSize + 2];
+  size_t frameLength = cobsEncode(record, length, frame);
+  frame[frameLength++] = 0;
+  if (port->availableForWrite() < int(frameLength)) { return false; }
+  port->write(frame, frameLength);
+  sequence++;
+  return true;
+}
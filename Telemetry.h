@@ -0,0 +1,20 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+#include <Arduino.h>
+#include <UiLayout.h>
+
+class Telemetry {
+    HardwareSerial *port;
+    unsigned long period;   // Time between full records, in ms
+    unsigned long lastFull;
+    unsigned long lastStats;
+    uint8_t sequence;
+    int16_t sent[NumberOfTelemetryFields]; // Field values as last sent
+    bool send(uint8_t type, const int16_t *values, uint8_t count, uint16_t mask);
+  public:
+    void init(HardwareSerial &port, unsigned long baud, unsigned long periodMillis);
+    void update(const int16_t *fields);
+    void updateStats(const uint16_t *stats);
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef UILAYOUT_H_
+#define UILAYOUT_H_
+#include <stdint.h>
+
+/*
+ * Description of the user interface. Each table row is expanded with a macro X(...) to
+ * generate the enums here and the arrays, lookup tables and I2C frame packing in main.cpp.
+ * To add a parameter, readback or alarm, add a row; no indices need to be edited.
+ */
+
+/* Set parameters. Each has a display, an LED next to it and one byte in the frame sent to the controller.
+ * The frame byte is the set value divided by wireDivisor.
+ *
+ * X(name, lcdPin, ledPin, isFloat, wireDivisor,
+ *   VC: initial, increment, minimum, maximum,  PC: initial, increment, minimum, maximum,
+ *   VC defaults: low, medium, high,            PC defaults: low, medium, high) */
+#define UI_SET_PARAMETERS(X) \
+    X(TidalVolume,    42, 27, false, 10, /* ml */          300, 10, 200, 450,   200, 0, 200, 300,   300, 350, 400,   250, 250, 250) \
+    X(Frequency,      40, 29, false, 1,  /* min^-1 */      12, 1, 5, 20,        12, 1, 5, 20,       16, 14, 12,      16, 12, 10) \
+    X(ItoERatio,      38, 31, true,  1,  /* 1:(value-10) */ 12, 1, 11, 15,      12, 1, 11, 15,      13, 12, 11,      13, 12, 11) \
+    X(MaxPressure,    36, 33, false, 1,  /* cmH2O */       5, 1, 0, 60,         5, 1, 15, 30,       30, 35, 40,      12, 15, 18) \
+    X(TriggerPresure, 34, 35, false, 1,  /* cmH2O */       0, 1, 0, 5,          0, 1, 0, 5,         0, 0, 0,         0, 0, 0)
+
+/* Values read back from the controller. Each has a display and one int16 in the received frame.
+ * X(name, lcdPin, isFloat) */
+#define UI_READBACKS(X) \
+    X(AchievedVolume, 28, false) \
+    X(AchievedPIP,    30, true) \
+    X(AchievedPEEP,   32, true)
+
+/* Alarms from the controller. Each has an LED and one int16 in the received frame, after the readbacks.
+ * X(name, ledPin) */
+#define UI_ALARMS(X) \
+    X(HighPressureAlarm,    A6) \
+    X(LowPressureAlarm,     A5) \
+    X(LowMinuteVolumeAlarm, A4) \
+    X(ElectronicsAlarm,     A3) \
+    X(AlarmMute,            A2)
+
+#define UI_ENUM_NAME(name, ...) name,
+#define UI_ENUM_SET_DISPLAY(name, ...) Set##name,
+#define UI_ENUM_VALUE(name, ...) name##Value,
+#define UI_ENUM_SLOT(name, ...) name##Slot,
+
+enum setParameters { UI_SET_PARAMETERS(UI_ENUM_NAME) NumberOfSetParameters };
+enum readbacks { UI_READBACKS(UI_ENUM_VALUE) NumberOfReadbacks };
+enum alarms { UI_ALARMS(UI_ENUM_NAME) numberOfAlarms };
+
+/* Set parameter displays come first, so a set parameter is also the index of its display. */
+enum namesOfDisplays { UI_SET_PARAMETERS(UI_ENUM_SET_DISPLAY) UI_READBACKS(UI_ENUM_NAME) NumberOfDisplays };
+
+/* Layout of the int16 values received from the controller: readbacks, then alarms. */
+enum receivedValues { FirstReadbackValue = 0, FirstAlarmValue = NumberOfReadbacks, NumberOfReceivedVals = NumberOfReadbacks + numberOfAlarms };
+
+/* Pressure waveform blocks from the controller: a tag byte, then one byte per sample in cmH2O.
+ * They are told apart from the readback frame by their length and tag. */
+const uint8_t WaveformFrameTag = 0xA5;
+const int WaveformBlockSize = 16;
+const int WaveformFrameSize = 1 + WaveformBlockSize;
+const unsigned long WaveformSampleMillis = 20; // The controller samples pressure at 50 Hz
+static_assert(WaveformFrameSize != 2 * NumberOfReceivedVals, "Waveform and readback frames must differ in length");
+static_assert(WaveformFrameSize <= 32, "Waveform frame must fit in the Wire buffer");
+
+/* Layout of the bytes sent to the controller. */
+enum frameSlots
+{
+    OperatingModeSlot,      // 0: RunMode, 1: PauseMode
+    VentilationModeSlot,    // 0: VolumeControlMode, 1:VolumeControlSetup, 2: PressureControlMode, 3: PressureControlSetup
+    MuteSlot,               // 1 if muted
+    UI_SET_PARAMETERS(UI_ENUM_SLOT)
+    HeartbeatSlot,          // Changes every loop pass while the UI is alive
+    FrameSize
+};
+
+/* Layout of the int16 fields in a telemetry record. At most 16, so a delta record can flag changes in a 16 bit mask. */
+#define UI_ENUM_FIELD(name, ...) name##Field,
+enum telemetryFields
+{
+    OperatingModeField,
+    VentilationModeField,
+    AlarmBitsField,         // Bit n is set if alarm n is active
+    UI_SET_PARAMETERS(UI_ENUM_FIELD)
+    UI_READBACKS(UI_ENUM_FIELD)
+    NumberOfTelemetryFields
+};
+static_assert(NumberOfTelemetryFields <= 16, "Telemetry delta mask is 16 bits");
+
+/* I2C slave statistics, counted since reset. Counts wrap at 65535. */
+enum i2cStatistics
+{
+    FramesReceivedStat,     // Readback frames accepted
+    WaveformBlocksStat,     // Waveform blocks accepted
+    FramesRejectedStat,     // Writes of the wrong length, or waveform blocks dropped for lack of room
+    FramesRequestedStat,    // Frames sent to the controller
+    WorstCallbackMicrosStat, // Longest receiveEvent or requestEvent, in us. SCL is stretched while they run.
+    NumberOfI2cStats
+};
+
+/* Telemetry records, before COBS framing: type, sequence, payload, checksum.
+ * The checksum makes the sum of all record bytes zero. Values are little endian 16 bit.
+ * FullRecord payload:  every field.
+ * DeltaRecord payload: uint16 mask of changed fields, then each changed field in order.
+ * StatsRecord payload: every I2C statistic, unsigned. */
+enum telemetryRecords { FullRecord = 1, DeltaRecord = 2, StatsRecord = 3 };
+const int MaxTelemetryRecordSize = 2 + 2 + 2 * NumberOfTelemetryFields + 1;
+static_assert(int(NumberOfI2cStats) <= int(NumberOfTelemetryFields), "Stats record must fit in the largest record");
+
+#endif
@@ -0,0 +1,95 @@
+// Loop-stall watchdog. The AVR watchdog runs in interrupt + reset mode: the first
+// timeout fires WDT_vect, which records the running stage, and the second resets the board.
+
+#include <Watchdog.h>
+
+const uint16_t StallRecordMagic = 0x5A1D;
+
+/* Kept in .noinit so it survives the watchdog reset. A valid record means the interrupt fired
+   and the loop never recovered, so the reset followed. MCUSR cannot tell us this, as the
+   Mega2560 bootloader clears it before the sketch starts. */
+StallRecord stallRecord __attribute__((section(".noinit")));
+
+static Watchdog *armedWatchdog;
+static volatile uint8_t currentStage;
+static volatile unsigned long stageStart;
+static volatile unsigned long lastFeed;
+static volatile bool overran; // True if the interrupt fired but the loop recovered before the reset
+
+void disableWatchdogOnBoot() __attribute__((naked, used, section(".init3")));
+void disableWatchdogOnBoot() {
+  // A watchdog reset leaves the watchdog running on its shortest timeout, so stop it
+  // before the C runtime starts. WDRF must be cleared before the watchdog can be stopped.
+  MCUSR = 0;
+  wdt_disable();
+}
+
+ISR(WDT_vect) {
+  // The loop has missed its budget. Record where it was; the next timeout resets the board.
+  unsigned long now = millis();
+  stallRecord.magic = StallRecordMagic;
+  stallRecord.magicCheck = ~StallRecordMagic;
+  stallRecord.stage = currentStage;
+  stallRecord.stageMillis = now - stageStart;
+  stallRecord.loopMillis = now - lastFeed;
+  stallRecord.heartbeat = armedWatchdog->heartbeat();
+  overran = true;
+}
+
+void Watchdog::init(uint8_t timeout) {
+  // Report any stall from the last boot before calling this, as it clears the record.
+  armedWatchdog = this;
+  stallRecord.magic = 0;
+  overran = false;
+  beats = 0;
+  lastFeed = stageStart = millis();
+  uint8_t prescaler = (timeout & 0x07) | ((timeout & 0x08) ? _BV(WDP3) : 0);
+  uint8_t oldSREG = SREG;
+  cli();
+  wdt_reset();
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | _BV(WDE) | prescaler;
+  SREG = oldSREG;
+}
+
+void Watchdog::feed() {
+  // Call once per loop pass. The interrupt enable is cleared by hardware when WDT_vect
+  // fires, so re-arm it if the loop recovered before the reset. The record is then only
+  // an overrun, reported through hadOverrun(), so mark it as no longer a reset.
+  wdt_reset();
+  if (!(WDTCSR & _BV(WDIE))) {
+    WDTCSR |= _BV(WDIE);
+    stallRecord.magic = 0;
+  }
+  lastFeed = millis();
+  beats++;
+}
+
+void Watchdog::stage(uint8_t stage) {
+  // Mark the start of a stage, so a stall can be attributed to it.
+  currentStage = stage;
+  stageStart = millis();
+}
+
+bool Watchdog::hadStallReset() {
+  // True once if the last reset was caused by a stall. The record stays readable through lastStall().
+  bool result = stallRecord.magic == StallRecordMagic && stallRecord.magicCheck == uint16_t(~StallRecordMagic);
+  stallRecord.magic = 0;
+  return result;
+}
+
+bool Watchdog::hadOverrun() {
+  // True once if the loop overran its budget but recovered before the reset.
+  bool result = overran;
+  overran = false;
+  return result;
+}
+
+const StallRecord &Watchdog::lastStall() {
+  return stallRecord;
+}
+
+uint8_t Watchdog::heartbeat() {
+  // Increments once per loop pass, so the controller can see the UI is alive.
+  return beats;
+}
@@ -0,0 +1,28 @@
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+#include <Arduino.h>
+#include <avr/wdt.h>
+
+// Record of a loop stall, written by the watchdog interrupt just before the reset.
+struct StallRecord {
+    uint16_t magic;        // StallRecordMagic when the record is valid
+    uint16_t magicCheck;   // Complement of magic, so random RAM after power-up is not taken for a record
+    uint8_t stage;         // The loop stage that was running when the watchdog fired
+    uint16_t stageMillis;  // How long that stage had been running
+    uint16_t loopMillis;   // How long since the loop last fed the watchdog
+    uint8_t heartbeat;     // Heartbeat count at the time of the stall
+};
+
+class Watchdog {
+    uint8_t beats;
+  public:
+    void init(uint8_t timeout); // Arm with one of the WDTO_* budgets from avr/wdt.h
+    void feed();
+    void stage(uint8_t stage);
+    bool hadStallReset();
+    bool hadOverrun();
+    const StallRecord &lastStall();
+    uint8_t heartbeat();
+};
+
+#endif
@@ -0,0 +1,103 @@
+// Live pressure waveform. The controller streams blocks of samples over I2C, which are
+// copied straight from the Wire buffer into a ring. The loop plays them back at the sample
+// rate as a bar graph across one or more displays, redrawn at a fixed frame rate.
+
+#include <Waveform.h>
+#include <Wire.h>
+
+const unsigned long FrameMillis = 40;     // Redraw the bar at 25 frames per second
+const unsigned long TimeoutMillis = 500;  // Revert to readbacks if no block arrives for this long
+const int LevelsPerPanel = 8;             // Two bars per digit: left (E, F) and right (B, C)
+
+void PressureWaveform::init(TM1637Display *panels, uint8_t numberOfPanels, uint8_t fullScale) {
+  this->panels = panels;
+  this->numberOfPanels = numberOfPanels;
+  this->fullScale = fullScale;
+  head = tail = 0;
+  active = false;
+  level = -1;
+  lastFrame = millis();
+}
+
+bool PressureWaveform::ingest() {
+  // Called from receiveEvent once the tag byte has been read. Copy the block into the ring,
+  // or drop it whole if there is no room, so the loop never sees a partial block.
+  // Returns false if the block was dropped.
+  uint8_t h = head;
+  uint8_t space = (tail - h - 1) & (RingSize - 1);
+  if (Wire.available() > space) {
+    while (Wire.available()) { Wire.read(); }
+    return false;
+  }
+  while (Wire.available()) {
+    samples[h] = Wire.read();
+    h = (h + 1) & (RingSize - 1);
+  }
+  head = h;
+  lastIngest = millis();
+  active = true;
+  return true;
+}
+
+void PressureWaveform::render() {
+  // Once per frame, take the samples due since the last frame and draw their peak,
+  // so short pressure peaks are not lost between frames.
+  unsigned long now = millis();
+  uint8_t available = (head - tail) & (RingSize - 1);
+  if (available == 0) {
+    /* Hold the playback clock while there is nothing to play. A block is then played out over
+       the following block period, one block behind the controller, rather than all at once. */
+    lastFrame = now;
+    if (!active) { return; }
+    noInterrupts();
+    if (head == tail && now - lastIngest > TimeoutMillis) {
+      active = false;
+      level = -1;
+    }
+    interrupts();
+    return;
+  }
+  if (now - lastFrame < FrameMillis) { return; }
+
+  /* The controller's clock drifts against ours. Keep at most two blocks queued, so latency stays bounded. */
+  if (available > 2 * WaveformBlockSize) {
+    tail = (head - WaveformBlockSize) & (RingSize - 1);
+    available = WaveformBlockSize;
+  }
+  /* Frames come late when the loop is busy, so take every sample due since the last frame and
+     advance by whole sample periods, keeping playback at the sample rate. */
+  unsigned long due = (now - lastFrame) / WaveformSampleMillis;
+  if (due > available) {
+    due = available; // Only after a loop pass longer than a block; restart the clock from here
+    lastFrame = now;
+  } else {
+    lastFrame += due * WaveformSampleMillis;
+  }
+  uint8_t peak = 0;
+  for (uint8_t i = 0; i < uint8_t(due); i++) {
+    if (samples[tail] > peak) { peak = samples[tail]; }
+    tail = (tail + 1) & (RingSize - 1);
+  }
+
+  int levels = LevelsPerPanel * numberOfPanels;
+  int newLevel = min(int(peak) * levels / fullScale, levels);
+  if (newLevel != level) { drawBar(newLevel); }
+}
+
+void PressureWaveform::drawBar(int level) {
+  // Draw a horizontal bar of 'level' half-digits, running across the panels in order.
+  this->level = level;
+  for (uint8_t p = 0; p < numberOfPanels; p++) {
+    uint8_t segments[4];
+    for (uint8_t d = 0; d < 4; d++) {
+      int bar = p * LevelsPerPanel + d * 2;
+      segments[d] = (level > bar ? SEG_E | SEG_F : 0) | (level > bar + 1 ? SEG_B | SEG_C : 0);
+    }
+    panels[p].setSegments(segments);
+  }
+}
+
+bool PressureWaveform::isActive() {
+  // True while the panels are showing the waveform instead of readbacks.
+  return active;
+}
@@ -0,0 +1,27 @@
+#ifndef WAVEFORM_H_
+#define WAVEFORM_H_
+#include <Arduino.h>
+#include <TM1637Display.h>
+#include <UiLayout.h>
+
+class PressureWaveform {
+    static const uint8_t RingSize = 64; // Must be a power of two
+    uint8_t samples[RingSize];
+    volatile uint8_t head;                  // Written only by ingest(), in the I2C interrupt
+    uint8_t tail;                           // Written only by render(), in the loop
+    volatile unsigned long lastIngest;
+    volatile bool active;                   // True while the controller is streaming
+    TM1637Display *panels;
+    uint8_t numberOfPanels;
+    uint8_t fullScale;                      // Pressure shown as a full bar, in cmH2O
+    int level;                              // Bar length last drawn
+    unsigned long lastFrame;
+    void drawBar(int level);
+  public:
+    void init(TM1637Display *panels, uint8_t numberOfPanels, uint8_t fullScale);
+    bool ingest();
+    void render();
+    bool isActive();
+};
+
+#endif
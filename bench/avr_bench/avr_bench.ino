@@ -0,0 +1,2 @@
+// Cycle benchmarks for the UI firmware. The benchmarks are in bench.cpp; build and run
+// them under simavr with bench/run_bench.sh.
@@ -0,0 +1,162 @@
+// Cycle benchmarks for the UI firmware, run on the ATmega2560 under simavr.
+// Timer1 counts CPU cycles, and its overflow interrupt extends the count to 32 bits.
+// Timer0 interrupts are stopped while measuring, so millis() is frozen, button sampling is
+// off and results repeat exactly. Results are printed on Serial as
+// "bench <name> cycles=<mean per call> worst=<worst call>", and the run ends by sleeping
+// with interrupts off, which stops simavr.
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include <Wire.h>
+
+/* Stands in for Wire in the firmware built below, so the I2C callbacks can be called directly
+   on staged bytes. Measurements through it leave out the TWI interrupt and state machine. */
+class BenchWire {
+    uint8_t rxBuffer[BUFFER_LENGTH], rxLength, rxIndex;
+    uint8_t txBuffer[BUFFER_LENGTH], txLength;
+  public:
+    void begin(uint8_t) {}
+    void onRequest(void (*)(void)) {}
+    void onReceive(void (*)(int)) {}
+    void stage(const uint8_t *data, uint8_t length) {
+      // Copy a received write into the buffer, as the core does before calling onReceive.
+      for (rxLength = 0; rxLength < length; rxLength++) { rxBuffer[rxLength] = data[rxLength]; }
+      rxIndex = 0;
+    }
+    int available() { return rxLength - rxIndex; }
+    int peek() { return rxIndex < rxLength ? rxBuffer[rxIndex] : -1; }
+    int read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+    size_t write(const uint8_t *data, size_t length) {
+      // Copy the frame byte by byte, as twi_transmit() does into the TWI buffer.
+      for (txLength = 0; txLength < length; txLength++) { txBuffer[txLength] = data[txLength]; }
+      return length;
+    }
+};
+static BenchWire benchWire;
+#define Wire benchWire
+
+/* Build the firmware in this translation unit, with its setup() and loop() renamed. */
+#define setup uiSetup
+#define loop uiLoop
+#include <main.cpp>
+#undef setup
+#undef loop
+#include <Led.cpp>
+#include <Watchdog.cpp>
+#include <IsrButton.cpp>
+#include <Telemetry.cpp>
+#include <Waveform.cpp>
+
+static volatile uint16_t timer1Overflows;
+ISR(TIMER1_OVF_vect) { timer1Overflows++; }
+
+static uint32_t __attribute__((noinline)) cycleCount() {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = TCNT1;
+  uint16_t overflows = timer1Overflows;
+  if ((TIFR1 & _BV(TOV1)) && count < 0x8000) { overflows++; } // Overflow pending but not yet serviced
+  SREG = oldSREG;
+  return ((uint32_t)overflows << 16) | count;
+}
+
+static uint32_t overhead = 0; // Cycles taken by an empty measurement
+
+static void report(const char *name, uint32_t cycles, uint32_t worst) {
+  Serial.print("bench ");
+  Serial.print(name);
+  Serial.print(" cycles=");
+  Serial.print(cycles);
+  Serial.print(" worst=");
+  Serial.println(worst);
+  Serial.flush(); // Keep the UART interrupt out of the next measurement
+}
+
+/* Run 'code' 'runs' times and report the mean and worst cycles per run. */
+#define BENCH(name, runs, code) do { \
+    uint32_t total = 0, worst = 0; \
+    for (uint16_t run = 0; run < (runs); run++) { \
+      uint32_t start = cycleCount(); \
+      code; \
+      uint32_t elapsed = cycleCount() - start - overhead; \
+      total += elapsed; \
+      if (elapsed > worst) { worst = elapsed; } \
+    } \
+    report(name, total / (runs), worst); \
+  } while (0)
+
+static void setAlarms(bool active) {
+  for (int i = 0; i < numberOfAlarms; i++) {
+    receivedParameterValues[FirstAlarmValue + i] = active;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  for (int i = 0; i < NumberOfDisplays; i++) {
+    arrayOfDisplays[i].init(LCD_PIN_CLK, DisplayPins[i]);
+    arrayOfDisplays[i].setBrightness(LCDbrightness, true);
+  }
+  for (int i = 0; i < NumberOfSetParameters; i++) {
+    arrayOfSetParameterLEDs[i].init(SetParameterLEDPins[i], false);
+  }
+  for (int i = 0; i < numberOfAlarms; i++) {
+    arrayOfAlarmLEDs[i].init(ArrayOfAlarmLEDPins[i], false);
+  }
+  SetDefaultParameters(ventilationMode, DefaultMedium);
+
+  TIMSK0 = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); // Count every CPU cycle
+  TIMSK1 = _BV(TOIE1);
+  uint32_t start = cycleCount();
+  overhead = cycleCount() - start;
+
+  Led &led = arrayOfSetParameterLEDs[0];
+  BENCH("led_on", 100, led.on());
+  BENCH("led_off", 100, led.off());
+  BENCH("led_blink", 100, led.blink(120));
+
+  /* Step every parameter up and down through its range, as the encoder does in Setting mode. */
+  BENCH("step_target_value", 100, {
+    int i = run % NumberOfSetParameters;
+    targetParameterValues[i] = StepTargetParameterValue(i, (run & 1) ? 1 : -1);
+  });
+
+  BENCH("set_default_parameters", 4, SetDefaultParameters(VolumeControlMode, run % 3));
+  BENCH("display_readbacks", 4, DisplayReceivedParameterValues());
+  BENCH("pack_data_to_send", 100, PackDataToSend());
+
+  setAlarms(false);
+  BENCH("show_alarms_clear", 100, showAlarms());
+  setAlarms(true);
+  BENCH("show_alarms_active", 100, showAlarms());
+
+  /* The I2C callbacks run inside the TWI interrupt, so report their worst case over
+     frames with and without alarms. Each includes the copy of the frame through benchWire,
+     standing in for the core's copy, but not the TWI interrupt or state machine. */
+  int16_t quiet[NumberOfReceivedVals] = {0};
+  int16_t alarming[NumberOfReceivedVals] = {0};
+  for (int i = 0; i < numberOfAlarms; i++) { alarming[FirstAlarmValue + i] = 1; }
+  BENCH("receive_event", 100, {
+    Wire.stage((uint8_t *)((run & 1) ? alarming : quiet), sizeof(quiet));
+    receiveEvent(sizeof(quiet));
+  });
+  BENCH("request_event", 100, requestEvent());
+
+  /* Waveform blocks, as many as fit in the ring, which is not drained here. */
+  uint8_t block[WaveformFrameSize] = {WaveformFrameTag};
+  BENCH("receive_waveform", 3, {
+    Wire.stage(block, sizeof(block));
+    receiveEvent(sizeof(block));
+  });
+
+  Serial.println("bench done");
+  Serial.flush();
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop() {
+}
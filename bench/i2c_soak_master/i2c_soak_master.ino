@@ -0,0 +1,135 @@
+// I2C soak test for the UI board. Flash this on a second Arduino wired to the UI's I2C bus
+// (SDA, SCL and GND, with about 2k2 pull-ups) and it stands in for the ventilator controller.
+// At each target rate in turn it runs transactions at 400 kHz for five seconds. Each
+// transaction writes a readback frame, or every fourth time a waveform block, then reads
+// the UI frame. It prints the sustained transactions per second, write and read NACKs,
+// corrupt frames, the worst transaction time, and how far that exceeds the ideal bus time.
+// The excess includes clock stretching and this board's own overhead, so it only bounds the
+// UI's callback time. The UI's worst callback (ISR) time is reported only by its telemetry
+// stats records, as WorstCallbackMicros (tools/telemetry_decode.cpp).
+// Start the soak after the UI has finished its start-up display, or the first frames may
+// be counted as corrupt.
+//
+// Build with the repository on the include path, for example:
+//   arduino-cli compile --fqbn arduino:avr:uno --build-property "compiler.cpp.extra_flags=-I/path/to/repo" bench/i2c_soak_master
+
+#include <Wire.h>
+#include <UiLayout.h>
+
+#define DEVICE 8
+const unsigned long BusClock = 400000;
+const unsigned long StepMillis = 5000;
+const unsigned int TargetRates[] = {50, 100, 200, 400, 800, 1600, 0}; // Transactions per second. 0 runs flat out.
+const int NumberOfRates = sizeof(TargetRates) / sizeof(TargetRates[0]);
+const uint8_t WaveformEvery = 4;
+
+/* Time on the bus with no clock stretching: 9 clocks per byte including the address, plus start and stop. */
+const unsigned long ReadbackWriteMicros = ((1 + 2 * NumberOfReceivedVals) * 9 + 2) * 1000000UL / BusClock;
+const unsigned long WaveformWriteMicros = ((1 + WaveformFrameSize) * 9 + 2) * 1000000UL / BusClock;
+const unsigned long ReadMicros = ((1 + FrameSize) * 9 + 2) * 1000000UL / BusClock;
+
+unsigned long transactions, writeNacks, readNacks, corruptFrames, worstMicros, worstExcessMicros;
+bool haveHeartbeat;
+uint8_t lastHeartbeat;
+
+/* Frame slot and range of each set parameter byte, over both ventilation modes. */
+struct byteRange { uint8_t slot, minimum, maximum; };
+#define SOAK_SET_RANGE(name, lcdPin, ledPin, isFloat, wireDivisor, vcInitial, vcIncrement, vcMinimum, vcMaximum, \
+                       pcInitial, pcIncrement, pcMinimum, pcMaximum, ...) \
+    { name##Slot, uint8_t(min(vcMinimum, pcMinimum) / wireDivisor), uint8_t(max(vcMaximum, pcMaximum) / wireDivisor) },
+const byteRange SetParameterRanges[NumberOfSetParameters] = { UI_SET_PARAMETERS(SOAK_SET_RANGE) };
+
+bool writeFrame(unsigned long count) {
+  // Write a readback frame with changing values, or a waveform block of a pressure ramp.
+  // Returns false if the UI did not acknowledge.
+  Wire.beginTransmission(DEVICE);
+  if (count % WaveformEvery == 0) {
+    Wire.write(WaveformFrameTag);
+    for (int i = 0; i < WaveformBlockSize; i++) { Wire.write(uint8_t((count + i) % 40)); }
+  } else {
+    int16_t values[NumberOfReceivedVals] = {0}; // No alarms
+    for (int i = 0; i < NumberOfReadbacks; i++) { values[FirstReadbackValue + i] = count % 1000; }
+    Wire.write((uint8_t *)values, sizeof(values));
+  }
+  return Wire.endTransmission() == 0;
+}
+
+bool isFrameValid(const uint8_t *frame) {
+  // The master always reads a full frame; bytes the UI did not send read as 0xFF.
+  // A short or torn frame therefore shows as out-of-range modes or set values, or as a
+  // heartbeat that goes backwards.
+  if (frame[OperatingModeSlot] > 1 || frame[VentilationModeSlot] > 3 || frame[MuteSlot] > 1) { return false; }
+  for (int i = 0; i < NumberOfSetParameters; i++) {
+    uint8_t value = frame[SetParameterRanges[i].slot];
+    if (value < SetParameterRanges[i].minimum || value > SetParameterRanges[i].maximum) { return false; }
+  }
+  uint8_t heartbeat = frame[HeartbeatSlot];
+  bool advancing = !haveHeartbeat || uint8_t(heartbeat - lastHeartbeat) < 128;
+  haveHeartbeat = true;
+  lastHeartbeat = heartbeat;
+  return advancing;
+}
+
+void runTransaction() {
+  unsigned long start = micros();
+  bool waveform = transactions % WaveformEvery == 0;
+  if (!writeFrame(transactions)) { writeNacks++; }
+  // requestFrom returns 0 if the address was not acknowledged, otherwise the full length.
+  uint8_t received = Wire.requestFrom(DEVICE, FrameSize);
+  uint8_t frame[FrameSize];
+  for (uint8_t i = 0; i < received; i++) { frame[i] = Wire.read(); }
+  unsigned long elapsed = micros() - start;
+
+  if (received != FrameSize) { readNacks++; }
+  else if (!isFrameValid(frame)) { corruptFrames++; }
+  transactions++;
+
+  unsigned long ideal = (waveform ? WaveformWriteMicros : ReadbackWriteMicros) + ReadMicros;
+  if (elapsed > worstMicros) { worstMicros = elapsed; }
+  if (elapsed > ideal && elapsed - ideal > worstExcessMicros) { worstExcessMicros = elapsed - ideal; }
+}
+
+void runStep(unsigned int rate) {
+  // Run transactions at 'rate' per second for one step and print the results.
+  transactions = writeNacks = readNacks = corruptFrames = worstMicros = worstExcessMicros = 0;
+  haveHeartbeat = false;
+  unsigned long period = rate ? 1000000UL / rate : 0;
+  unsigned long stepStart = millis();
+  unsigned long next = micros();
+  while (millis() - stepStart < StepMillis) {
+    if (period) {
+      while (long(micros() - next) < 0) {}
+      next += period;
+    }
+    runTransaction();
+  }
+  unsigned long elapsed = millis() - stepStart;
+
+  Serial.print("soak target=");
+  if (rate) { Serial.print(rate); } else { Serial.print("max"); }
+  Serial.print(" fps=");
+  Serial.print(transactions * 1000UL / elapsed);
+  Serial.print(" write_nacks=");
+  Serial.print(writeNacks);
+  Serial.print(" read_nacks=");
+  Serial.print(readNacks);
+  Serial.print(" corrupt=");
+  Serial.print(corruptFrames);
+  Serial.print(" worst_us=");
+  Serial.print(worstMicros);
+  Serial.print(" excess_us=");
+  Serial.println(worstExcessMicros);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Wire.begin();
+  Wire.setClock(BusClock);
+  for (int i = 0; i < NumberOfRates; i++) {
+    runStep(TargetRates[i]);
+  }
+  Serial.println("soak done");
+}
+
+void loop() {
+}
@@ -0,0 +1,66 @@
+#!/bin/sh
+# Build the cycle benchmarks for the ATmega2560, run them under simavr and compare the
+# results with bench/baseline.txt. Needs arduino-cli with the arduino:avr core and the
+# TM1637Display and Encoder libraries installed, and simavr on the PATH.
+#
+#   bench/run_bench.sh            Run and compare. Exits non-zero if a result regresses,
+#                                 has no baseline entry, or a baseline entry has no result.
+#   bench/run_bench.sh --update   Run and write the results as the new baseline.
+#
+# TOLERANCE sets the allowed regression in percent (default 2).
+
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+REPO=$(dirname "$HERE")
+BUILD=${BUILD:-"$REPO/_bench_build"}
+TOLERANCE=${TOLERANCE:-2}
+
+arduino-cli compile --fqbn arduino:avr:mega:cpu=atmega2560 --build-path "$BUILD" \
+    --build-property "compiler.cpp.extra_flags=-I$REPO" "$HERE/avr_bench"
+
+# simavr colours the UART output, so strip the escape codes before picking out results.
+timeout 600 simavr -m atmega2560 -f 16000000 "$BUILD/avr_bench.ino.elf" 2>&1 \
+    | sed 's/\x1b\[[0-9;]*m//g' \
+    | grep -o 'bench [a-z_]* cycles=[0-9]* worst=[0-9]*' \
+    | sed 's/^bench //' > "$BUILD/results.txt" || true
+
+if [ ! -s "$BUILD/results.txt" ]; then
+    echo "No benchmark results from simavr" >&2
+    exit 1
+fi
+
+if [ "$1" = "--update" ]; then
+    { grep '^#' "$HERE/baseline.txt"; cat "$BUILD/results.txt"; } > "$BUILD/baseline.txt"
+    mv "$BUILD/baseline.txt" "$HERE/baseline.txt"
+    cat "$HERE/baseline.txt"
+    exit 0
+fi
+
+awk -v tolerance="$TOLERANCE" '
+    FNR == NR { if ($1 !~ /^#/ && NF) { base[$1] = $0 }; next }
+    {
+        seen[$1] = 1
+        split($2, cycles, "="); split($3, worst, "=")
+        if (!($1 in base)) {
+            printf "%-24s cycles=%-8d worst=%-8d NO BASELINE (run with --update)\n", $1, cycles[2], worst[2]
+            failed = 1
+            next
+        }
+        split(base[$1], b, /[ =]+/)
+        status = "ok"
+        if (cycles[2] > b[3] * (1 + tolerance / 100) || worst[2] > b[5] * (1 + tolerance / 100)) {
+            status = "REGRESSED"
+            failed = 1
+        }
+        printf "%-24s cycles=%-8d worst=%-8d baseline %d / %d  %s\n", $1, cycles[2], worst[2], b[3], b[5], status
+    }
+    END {
+        for (name in base) {
+            if (!(name in seen)) {
+                printf "%-24s MISSING (in the baseline but not in the results)\n", name
+                failed = 1
+            }
+        }
+        exit failed
+    }
+' "$HERE/baseline.txt" "$BUILD/results.txt"
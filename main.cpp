@@ -1,50 +1,41 @@
 #include <TM1637Display.h>
 #include <Encoder.h>
 #include <Led.h>
-#include "OneButton.h"
+#include <Watchdog.h>
+#include <IsrButton.h>
 #include <string.h>
 #include <Wire.h>
+#include <UiLayout.h>
+#include <Telemetry.h>
+#include <Waveform.h>
 
 #pragma region headers
 
-/* Define display pins and make an array */
+/* Make an array of display pins from the UI layout. Set parameter displays come first, then readbacks. */
 #define LCD_PIN_CLK 26 // Common clock pin for all TM1637 boards.
-#define LCD_PIN_1 42   // Tidal vol
-#define LCD_PIN_2 40   // Frequency
-#define LCD_PIN_3 38   // IE
-#define LCD_PIN_4 36   // Pmax
-#define LCD_PIN_5 34   // Ptrig
-#define LCD_PIN_6 28   // tv achieved
-#define LCD_PIN_7 30   // PIP
-#define LCD_PIN_8 32   // PEEP
-const int DisplayPins[] = {LCD_PIN_1, LCD_PIN_2, LCD_PIN_3, LCD_PIN_4, LCD_PIN_5, LCD_PIN_6, LCD_PIN_7, LCD_PIN_8};
+#define UI_SET_PARAMETER_LCD_PIN(name, lcdPin, ...) lcdPin,
+#define UI_READBACK_LCD_PIN(name, lcdPin, ...) lcdPin,
+const int DisplayPins[] = { UI_SET_PARAMETERS(UI_SET_PARAMETER_LCD_PIN) UI_READBACKS(UI_READBACK_LCD_PIN) };
 const uint8_t LCDbrightness = 7;
-enum namesOfDisplays{ SetTidalVolume, SetFrequency, SetItoE, SetMaxPresure, SetTriggerPressure, AchievedVolume, AchievedPIP, AchievedPEEP };
 const uint8_t nullSegments[] = {SEG_G, SEG_G, SEG_G, SEG_G};
 
 /* Instantiate each display in an array of TM1637 objects. They will be initialised during setup. */
-const int NumberOfDisplays = 8;
 TM1637Display arrayOfDisplays[NumberOfDisplays];
 
-/* Define SET PARAMETER LED pins and make an array */
-#define LED_PIN_DISPLAY_1 27 // Tidal vol
-#define LED_PIN_DISPLAY_2 29 // Frequency
-#define LED_PIN_DISPLAY_3 31 // IE
-#define LED_PIN_DISPLAY_4 33 // Pmax
-#define LED_PIN_DISPLAY_5 35 // Ptrig
-const int SetParameterLEDPins[] = {LED_PIN_DISPLAY_1, LED_PIN_DISPLAY_2, LED_PIN_DISPLAY_3, LED_PIN_DISPLAY_4, LED_PIN_DISPLAY_5};
-const int NumberOfSetParameters = sizeof(SetParameterLEDPins) / sizeof(SetParameterLEDPins[0]);
+/* Make an array of SET PARAMETER LED pins from the UI layout */
+#define UI_SET_PARAMETER_LED_PIN(name, lcdPin, ledPin, ...) ledPin,
+const int SetParameterLEDPins[] = { UI_SET_PARAMETERS(UI_SET_PARAMETER_LED_PIN) };
 Led arrayOfSetParameterLEDs[NumberOfSetParameters]; // Each of these LEDs is positioned next to a display.
 
-/* Instantiate button objects */
-OneButton startButton(4);   // ON
-OneButton modeButton(5);    // START
-OneButton defaultButton(6); // PAUSE
-OneButton muteButton(A7);    // ALARM MUTE
-OneButton selectButton(A0);  // SELECT (ENCODER BUTTON)
+/* Instantiate button objects. They are sampled from a timer interrupt, and their callbacks run from the loop. */
+IsrButton startButton(4);   // ON
+IsrButton modeButton(5);    // START
+IsrButton defaultButton(6); // PAUSE
+IsrButton muteButton(A7);    // ALARM MUTE
+IsrButton selectButton(A0);  // SELECT (ENCODER BUTTON)
 
 /* Crete a pointer array to allow looping through each button */
-OneButton *arrayOfButtons[] = {&startButton, &modeButton, &defaultButton, &muteButton, &selectButton };
+IsrButton *arrayOfButtons[] = {&startButton, &modeButton, &defaultButton, &muteButton, &selectButton };
 const int NumberOfButtons = sizeof(arrayOfButtons) / sizeof(arrayOfButtons[0]);
 void CallWhenPressed(void *inButton);
 void CallWhenUnpressed(void *inButton);
@@ -105,18 +96,13 @@ int targetParameterValues[NumberOfSetParameters]; // The paramater values as dis
 int setParameterIndex = 0; // The parameter enum name or index used to select a parameter in above arrays. 
 int targetParameterIndex = 0; // The enum name or index used when the user is selecting a different parameter
 void DisplayReceivedParameterValues();
+int StepTargetParameterValue(int parameterIndex, int encoderOutput);
 
-/* Define and instantiate the alarm LEDs, create array of state variables  */
-#define LED_PIN_HIGH_PRES_ALARM A6
-#define LED_PIN_LOW_PRES_ALARM A5
-#define LED_PIN_LOW_MINUTE_VOL A4
-#define LED_PIN_ELECTRONICS A3
-#define LED_PIN_ALARM_MUTE  A2
-const int ArrayOfAlarmLEDPins[] = {LED_PIN_HIGH_PRES_ALARM, LED_PIN_LOW_PRES_ALARM, LED_PIN_LOW_MINUTE_VOL, LED_PIN_ELECTRONICS, LED_PIN_ALARM_MUTE};
-Led arrayOfAlarmLEDs[5];
-
-const int numberOfAlarms = sizeof(ArrayOfAlarmLEDPins) / sizeof(ArrayOfAlarmLEDPins[0]);
-bool isAlarmActive[numberOfAlarms] = {0, 0, 0, 0, 0}; 
+/* Instantiate the alarm LEDs from the UI layout, create array of state variables  */
+#define UI_ALARM_LED_PIN(name, ledPin) ledPin,
+const int ArrayOfAlarmLEDPins[] = { UI_ALARMS(UI_ALARM_LED_PIN) };
+Led arrayOfAlarmLEDs[numberOfAlarms];
+bool isAlarmActive[numberOfAlarms]; 
 void showAlarms();
 void showAllAlarms();
 void clearAllAlarms();
@@ -172,13 +158,59 @@ unsigned long timeSinceIdle;
 const unsigned long MaxTimeSinceIdle = 5000; // Display will lock after 5 seconds .
 bool IsTimeToLock(unsigned long timeSinceIdle);
 
-/* Initialise I2C */
+/* Initialise I2C. The controller may run the bus in fast mode (400 kHz); as a slave we follow its clock, 
+ * holding SCL low while requestEvent and receiveEvent run, so they are kept short. 
+ * Fast mode needs external pull-ups (about 2k2); the internal ones are too weak. */
 #define DEVICE 8
 void requestEvent();
 void receiveEvent(int numberOfBytes);
-const int NumberOfReceivedVals = 8;
-int16_t receivedParameterValues[NumberOfReceivedVals];
-uint8_t dataToSend[NumberOfSetParameters + 3]; // operating mode + ventilation mode + alarm mute + Set parameters 
+uint16_t i2cStats[NumberOfI2cStats]; // See i2cStatistics in UiLayout.h. Written by the I2C callbacks.
+void RecordCallbackTime(unsigned long start);
+int16_t receivedParameterValues[NumberOfReceivedVals]; // Readbacks, then alarms. See receivedValues in UiLayout.h
+uint8_t dataToSend[FrameSize]; // See frameSlots in UiLayout.h
+void PackDataToSend();
+
+/* The live pressure waveform is drawn as a bar across the last readback displays while the controller streams it. */
+PressureWaveform pressureWaveform;
+const uint8_t NumberOfWaveformPanels = 2; // PIP and PEEP
+const uint8_t FirstWaveformPanel = NumberOfDisplays - NumberOfWaveformPanels;
+const uint8_t WaveformFullScale = 40; // cmH2O
+
+/* The attention line is raised when the frame content changes, and lowered when the controller reads it. */
+#define ATTENTION_PIN 22
+volatile uint8_t *attentionPort; // Output register and mask for the attention pin, so requestEvent can lower it quickly
+uint8_t attentionMask;
+uint8_t notifiedFrame[HeartbeatSlot]; // The frame content last signalled on the attention line. The heartbeat is not included.
+void NotifyIfFrameChanged();
+
+/* Optional binary telemetry for external monitoring. Comment out TELEMETRY_SERIAL to disable it.
+ * Serial1 keeps the records apart from the debug text; use Serial to share the USB port.
+ * Decode on the host with tools/telemetry_decode.cpp. */
+#define TELEMETRY_SERIAL Serial1
+const unsigned long TelemetryBaud = 115200;
+const unsigned long TelemetryPeriod = 100; // A full record is sent every 100 ms, and a delta record whenever a field changes.
+Telemetry telemetry;
+void SendTelemetry();
+
+/* Initialise the loop-stall watchdog. The board resets if a loop pass overruns twice the budget. 
+ * Each TM1637 write takes about 20 ms at the default bit delay, and the worst loop pass 
+ * (a default setting change in PC mode, with the waveform showing) makes about 16 of them. */
+Watchdog watchdog;
+const uint8_t LoopBudget = WDTO_500MS;
+enum loopStages
+{
+    SetupStage,
+    WaterfallStage,
+    ButtonStage,
+    DefaultStage,
+    InterfaceStage,
+    OperatingStage,
+    VentilationStage,
+    ReadbackStage,
+    FrameStage,
+    TelemetryStage
+};
+void ReportStalls();
 
 #pragma endregion headers
 
@@ -187,52 +219,24 @@ uint8_t dataToSend[NumberOfSetParameters + 3]; // operating mode + ventilation m
 /* Initialise Clinical Parameters */
 
 /* An array to allow lookup of the descrete set of values allowed for each parameter, in both VC and PC modes. */
+#define UI_LOOKUP_SET_PARAMETER(name, lcdPin, ledPin, isFloat, wireDivisor, vcInitial, vcIncrement, vcMinimum, vcMaximum, \
+                                pcInitial, pcIncrement, pcMinimum, pcMaximum, ...) \
+    {{vcInitial, vcIncrement, vcMinimum, vcMaximum}, {pcInitial, pcIncrement, pcMinimum, pcMaximum}},
 const int LookupSetParameter[NumberOfSetParameters][2][4] =
     {
         // {VC, PC} {Initial value, Increment, Minimum value, Maximum value }
-        {{300, 10, 200, 450}, // Tidal Volume / ml (VC)
-         {200, 0, 200, 300}},      // Tidal Volume / ml (PC)
-
-        {{12, 1, 5, 20}, // Frequency / min^-1 (VC)
-         {12, 1, 5, 20}}, // (PC)
-
-        {{12, 1, 11, 15}, // I/E ratio / 1:(value-10)
-         {12, 1, 11, 15}},
-
-        {{5, 1, 0, 60},  // Max Pressure (VC)
-         {5, 1, 15, 30}}, // PC
-
-        {{0, 1, 0, 5}, // Trigger pressure (VC)
-         {0, 1, 0, 5}} // (PC)
+        UI_SET_PARAMETERS(UI_LOOKUP_SET_PARAMETER)
     };
 /* An array to allow lookup of the descrete set of default values allowed for each parameter, in both VC and PC modes. */
+#define UI_DEFAULT_PARAMETERS(name, lcdPin, ledPin, isFloat, wireDivisor, vcInitial, vcIncrement, vcMinimum, vcMaximum, \
+                              pcInitial, pcIncrement, pcMinimum, pcMaximum, vcLow, vcMedium, vcHigh, pcLow, pcMedium, pcHigh) \
+    {{vcLow, vcMedium, vcHigh}, {pcLow, pcMedium, pcHigh}},
 const int DefaultParameters[NumberOfSetParameters][2][3] =
     {
         // {VC, PC} {Small, Medium, Large}
-        {{300, 350, 400}, // Tidal Volume / ml (VC)
-         {250, 250, 250}},      // Tidal Volume / ml (PC)
-
-        {{16, 14, 12}, // Frequency / min^-1 (VC)
-         {16, 12, 10}}, // (PC)
-
-        {{13, 12, 11}, // I/E ratio / 1:(value-10)
-         {13, 12, 11}},
-
-        {{30, 35, 40},  // Max Pressure (VC)
-         {12, 15, 18}}, // PC
-
-        {{0, 0, 0}, // Trigger pressure (VC)
-         {0, 0, 0}} // (PC)
+        UI_SET_PARAMETERS(UI_DEFAULT_PARAMETERS)
     };
 
-enum
-{
-    TidalVolume,
-    Frequency,
-    ItoERatio,
-    MaxPressure,
-    TriggerPresure
-};
 enum
 {
     InitialVal,
@@ -241,13 +245,20 @@ enum
     MaximumVal
 };
 
-bool isFloat[NumberOfSetParameters] = {false, false, true, false, false}; // Tidal volume and frequency are not floats, and IE as float to display 1:.
+#define UI_SET_PARAMETER_IS_FLOAT(name, lcdPin, ledPin, isFloat, ...) isFloat,
+bool isFloat[NumberOfSetParameters] = { UI_SET_PARAMETERS(UI_SET_PARAMETER_IS_FLOAT) }; // IE is shown as float to display 1:.
 #pragma endregion clinicalParameters
 
 /* Start Setup */
 void setup() {
     Serial.begin(9600);
     Serial.println("Setup...");
+    ReportStalls();
+    watchdog.init(LoopBudget);
+#ifdef TELEMETRY_SERIAL
+    telemetry.init(TELEMETRY_SERIAL, TelemetryBaud, TelemetryPeriod);
+#endif
+    watchdog.stage(SetupStage);
     /* Initialise the arrays of LCD, LED and button objects, and switch the LEDs off. */
     for (int i = 0; i < NumberOfDisplays; i++) {
         arrayOfDisplays[i].init(LCD_PIN_CLK, DisplayPins[i]);
@@ -271,26 +282,37 @@ void setup() {
         arrayOfButtons[i]->attachLongPressStart( CallWhenPressed, &isButtonPressed[i] );
         arrayOfButtons[i]->attachLongPressStop( CallWhenUnpressed, &isButtonPressed[i] );
     }
+    IsrButton::begin();
 
     showAllAlarms();
     /* Setup I2C */
+    pinMode(ATTENTION_PIN, OUTPUT);
+    digitalWrite(ATTENTION_PIN, LOW);
+    attentionPort = portOutputRegister(digitalPinToPort(ATTENTION_PIN));
+    attentionMask = digitalPinToBitMask(ATTENTION_PIN);
+    pressureWaveform.init(&arrayOfDisplays[FirstWaveformPanel], NumberOfWaveformPanels, WaveformFullScale);
     Wire.begin(DEVICE);
     Wire.onRequest(requestEvent);
     Wire.onReceive(receiveEvent);
     DisplayWaterfall(TimeForInit);
     clearAllAlarms();
     /* Set parameters from DefaultHigh on startup, but do not start in default high mode */ 
+    watchdog.feed();
+    watchdog.stage(DefaultStage);
     SetDefaultParameters(ventilationMode, DefaultMedium);
     arrayOfDisplays[TriggerPresure].setSegments(OffSegments);
 
 } // End of Setup
 
 void loop() {
-    /* Update Button States */ 
-    for (int i = 0; i < NumberOfButtons; i++) {
-        arrayOfButtons[i]->tick();
-    }
+    watchdog.feed();
+    ReportStalls();
 
+    /* Update Button States from the events queued by the button interrupt */ 
+    watchdog.stage(ButtonStage);
+    IsrButton::dispatch();
+
+    watchdog.stage(DefaultStage);
     if (operatingMode != RunMode ) { // Only change default settings if not running 
     /*  Default settings state machine */
         switch (defaultSetting) {
@@ -340,6 +362,7 @@ void loop() {
     }
 
     /*  Interface Mode state machine **/
+    watchdog.stage(InterfaceStage);
 	switch (interfaceMode) {
         case Locked:
 //          Start here, revert here if idle timeout, or if ventilation is confirmed. 
@@ -373,14 +396,17 @@ void loop() {
                 timeSinceIdle = millis();   // Reset lock timer
                 /* Change the target parameter and scroll the parameter LEDs */
                 arrayOfSetParameterLEDs[targetParameterIndex].off(); 
-                targetParameterIndex = targetParameterIndex + encoderSelectingDirection*encoderOutput / stepsPerDedent ;  
+                int step = encoderSelectingDirection*encoderOutput / stepsPerDedent ;
+                targetParameterIndex = targetParameterIndex + step ;  
             /*  Create hard stops at each end of the parameter list 
-                If in PC / setup mode, do not allow selection of VT. */
-                if ( ventilationMode == PressureControlMode || ventilationMode == PressureControlSetup) { 
-                    if ( targetParameterIndex < 1 ) { targetParameterIndex = 1; }   // Hard stop at bottom of list
-                }
-                else if (targetParameterIndex < 0 ) {targetParameterIndex = 0;} // Allow all values if not in VC modes 
+                If in PC / setup mode, do not allow selection of VT: skip over it, or stop short of it at an end of the list. */
+                if (targetParameterIndex < 0 ) {targetParameterIndex = 0;} // Hard stop at bottom of list
                 if ( targetParameterIndex > NumberOfSetParameters - 1 ) {targetParameterIndex = NumberOfSetParameters - 1;} // Hard stop at top of list.
+                if ( ( ventilationMode == PressureControlMode || ventilationMode == PressureControlSetup) && targetParameterIndex == TidalVolume ) { 
+                    int direction = step < 0 ? -1 : 1;
+                    targetParameterIndex = TidalVolume + direction;
+                    if ( targetParameterIndex < 0 || targetParameterIndex > NumberOfSetParameters - 1 ) { targetParameterIndex = TidalVolume - direction; }
+                }
                 arrayOfSetParameterLEDs[targetParameterIndex].on();
             }
 
@@ -408,18 +434,7 @@ void loop() {
             if ( mainEncoder.read() != 0 ) { // Then the target param has been changed ...
                 mainEncoder.write(0);       // Reset the encoder 
                 timeSinceIdle = millis();   // reset lock timer 
-                int numberOfIncrements =  (LookupSetParameter[setParameterIndex][isInPCMode][MaximumVal]  // ...
-                                  - LookupSetParameter[setParameterIndex][isInPCMode][MinimumVal])  // ...
-                                  / LookupSetParameter[setParameterIndex][isInPCMode][IncrementVal] + 1;
-                    //  Find the current index.
-                currentIndex = ( targetParameterValues[setParameterIndex] - LookupSetParameter[setParameterIndex][isInPCMode][MinimumVal] )  // ...
-                                    / LookupSetParameter[setParameterIndex][isInPCMode][IncrementVal];
-                targetIndex = ( encoderSettingDirection*encoderOutput / stepsPerDedent + currentIndex ) ;
-                if (targetIndex < 0 ) {targetIndex = 0;}
-                if (targetIndex >= numberOfIncrements) {targetIndex = numberOfIncrements - 1;}
-//              Calculate new Value according to parameter range (defined by ventilation mode) and target index. 
-                targetParameterValues[setParameterIndex] = LookupSetParameter[setParameterIndex][isInPCMode][MinimumVal]
-                                                        + LookupSetParameter[setParameterIndex][isInPCMode][IncrementVal] * targetIndex;
+                targetParameterValues[setParameterIndex] = StepTargetParameterValue(setParameterIndex, encoderOutput);
     //          Show current value
                 arrayOfDisplays[setParameterIndex].clear();
                 arrayOfDisplays[setParameterIndex].showNumberDecEx(targetParameterValues[setParameterIndex], isFloat[setParameterIndex]);
@@ -461,6 +476,7 @@ void loop() {
     }
 
     /*  Operating Mode state machine */
+    watchdog.stage(OperatingStage);
     switch (operatingMode) {
 
         case RunMode:
@@ -488,6 +504,7 @@ void loop() {
     }
 
     /* Ventilation Mode state machine */
+    watchdog.stage(VentilationStage);
     switch(ventilationMode) {
 //      React to button press
         case VolumeControlSetup:
@@ -587,19 +604,64 @@ void loop() {
     }
 
 //  Display Values from Ventilator
+    watchdog.stage(ReadbackStage);
     DisplayReceivedParameterValues();
+    pressureWaveform.render();
+    showAlarms();
 
 //  Fill up an array of 8 bit values to send over I2C
-    dataToSend[0] = uint8_t(operatingMode); // 0: RunMode, 1: PauseMode
-    dataToSend[1] = uint8_t(ventilationMode); // 0: VolumeControlMode, 1:VolumeControlSetup, 2: PressureControlMode, 3: PressureControlSetup
-    dataToSend[2] = uint8_t( isButtonClicked[MuteButton] || isButtonPressed[MuteButton] ); // if muted
-    for (int i = 0; i < NumberOfSetParameters ; i++) {
-        dataToSend[i+3] = setParameterValues[i] ;
-        dataToSend[3] = setParameterValues[0]/10;   // Tidal volume needs to be scaled
-    }
+    watchdog.stage(FrameStage);
+    noInterrupts(); // Keep requestEvent from sending a half-packed frame, or clearing the mute mid-comparison
+    PackDataToSend();
+    NotifyIfFrameChanged();
+    interrupts();
+
+    watchdog.stage(TelemetryStage);
+    SendTelemetry();
 
 } // End of Loop
 
+void PackDataToSend() {
+    /**
+    * Fill the frame sent over I2C. The set parameter slots are generated from the UI layout,
+    * each scaled by its wire divisor.
+    */
+    dataToSend[OperatingModeSlot] = uint8_t(operatingMode);
+    dataToSend[VentilationModeSlot] = uint8_t(ventilationMode);
+    dataToSend[MuteSlot] = uint8_t( isButtonClicked[MuteButton] || isButtonPressed[MuteButton] );
+#define UI_PACK_SET_PARAMETER(name, lcdPin, ledPin, isFloat, wireDivisor, ...) \
+    dataToSend[name##Slot] = uint8_t(setParameterValues[name] / wireDivisor);
+    UI_SET_PARAMETERS(UI_PACK_SET_PARAMETER)
+    dataToSend[HeartbeatSlot] = watchdog.heartbeat();
+}
+
+void SendTelemetry() {
+    /**
+    * Gather the UI state into telemetry fields and hand them to the telemetry sender,
+    * which decides whether a full or delta record is due.
+    */
+#ifdef TELEMETRY_SERIAL
+    int16_t fields[NumberOfTelemetryFields];
+    fields[OperatingModeField] = operatingMode;
+    fields[VentilationModeField] = ventilationMode;
+    fields[AlarmBitsField] = 0;
+    for (int i = 0; i < numberOfAlarms; i++) {
+        if (isAlarmActive[i]) { fields[AlarmBitsField] |= 1 << i; }
+    }
+#define UI_SET_PARAMETER_FIELD(name, ...) fields[name##Field] = setParameterValues[name];
+    UI_SET_PARAMETERS(UI_SET_PARAMETER_FIELD)
+#define UI_READBACK_FIELD(name, ...) fields[name##Field] = receivedParameterValues[FirstReadbackValue + name##Value];
+    UI_READBACKS(UI_READBACK_FIELD)
+    telemetry.update(fields);
+
+    uint16_t stats[NumberOfI2cStats];
+    noInterrupts();
+    memcpy(stats, i2cStats, sizeof(stats));
+    interrupts();
+    telemetry.updateStats(stats);
+#endif
+}
+
 void ClearButtons(int new_mode, int old_mode) {
     /**
     * Set all button array states to false to avoid presses or clicks
@@ -654,12 +716,33 @@ void CallWhenUnpressed(void *inButton){
     *i = false;
 }
 
+int StepTargetParameterValue(int parameterIndex, int encoderOutput) {
+    /**
+    * Return the target value of a parameter moved by the encoder output, 
+    * snapped to the parameter's increments and range in the current ventilation mode.
+    */
+    int numberOfIncrements =  (LookupSetParameter[parameterIndex][isInPCMode][MaximumVal]  // ...
+                      - LookupSetParameter[parameterIndex][isInPCMode][MinimumVal])  // ...
+                      / LookupSetParameter[parameterIndex][isInPCMode][IncrementVal] + 1;
+    //  Find the current index.
+    currentIndex = ( targetParameterValues[parameterIndex] - LookupSetParameter[parameterIndex][isInPCMode][MinimumVal] )  // ...
+                        / LookupSetParameter[parameterIndex][isInPCMode][IncrementVal];
+    targetIndex = ( encoderSettingDirection*encoderOutput / stepsPerDedent + currentIndex ) ;
+    if (targetIndex < 0 ) {targetIndex = 0;}
+    if (targetIndex >= numberOfIncrements) {targetIndex = numberOfIncrements - 1;}
+    //  Calculate new Value according to parameter range (defined by ventilation mode) and target index. 
+    return LookupSetParameter[parameterIndex][isInPCMode][MinimumVal]
+            + LookupSetParameter[parameterIndex][isInPCMode][IncrementVal] * targetIndex;
+}
+
 void SetDefaultParameters( int ventilationMode, int defaultSetting ) {
     /**
     * Display and set each of the setable parameters to default values, according to the current ventilation mode and default mode setting. 
     * If no default mode is selected then display the setparametes. 
     */
-    for (int i = isInPCMode; i < NumberOfSetParameters - 1; i++) { // Update all except P_trig, and Tv if in PC mode
+    for (int i = 0; i < NumberOfSetParameters; i++) { // Update all except P_trig, and Tv if in PC mode
+        if (i == TriggerPresure) { continue; }
+        if (isInPCMode && i == TidalVolume) { continue; }
         arrayOfDisplays[i].clear();
         if ( defaultSetting == NoDefault ) {
             // targetParameterValues[i] = setParameterValues[i] = DefaultParameters[i][isInPCMode][defaultSetting];
@@ -669,19 +752,23 @@ void SetDefaultParameters( int ventilationMode, int defaultSetting ) {
             targetParameterValues[i] = setParameterValues[i] = DefaultParameters[i][isInPCMode][defaultSetting];
             arrayOfDisplays[i].showNumberDecEx( setParameterValues[i] , isFloat[i]);
         } 
-        if (isInPCMode == 1) { arrayOfDisplays[TidalVolume].setSegments(nullSegments); }
-        arrayOfDisplays[TriggerPresure].setSegments(OffSegments);
     }
+    if (isInPCMode == 1) { arrayOfDisplays[TidalVolume].setSegments(nullSegments); }
+    arrayOfDisplays[TriggerPresure].setSegments(OffSegments);
 }
 
 void DisplayReceivedParameterValues() {
     /**
-    * Display the array of received parameters on the lower 3 displays.
+    * Display the array of received parameters on the readback displays,
+    * except those showing the pressure waveform.
     */
 
-    arrayOfDisplays[AchievedVolume].showNumberDecEx(receivedParameterValues[0], false);
-    arrayOfDisplays[AchievedPIP].showNumberDecEx(round(receivedParameterValues[1]), true);
-    arrayOfDisplays[AchievedPEEP].showNumberDecEx(receivedParameterValues[2], true);
+    bool showingWaveform = pressureWaveform.isActive();
+#define UI_DISPLAY_READBACK(name, lcdPin, isFloat) \
+    if (name < FirstWaveformPanel || !showingWaveform) { \
+        arrayOfDisplays[name].showNumberDecEx(receivedParameterValues[FirstReadbackValue + name##Value], isFloat); \
+    }
+    UI_READBACKS(UI_DISPLAY_READBACK)
 }
 
 void showAlarms() {
@@ -689,9 +776,9 @@ void showAlarms() {
      * Indicate if alarm occurred.
      */
     for ( int i = 0; i < numberOfAlarms; i++) {
-        isAlarmActive[i] = bool( receivedParameterValues[i + 3] ); //  The recieved alarm status are index 3-7 of the received data. 
+        isAlarmActive[i] = bool( receivedParameterValues[FirstAlarmValue + i] ); //  The recieved alarm status follow the readbacks. 
         if ( isAlarmActive[i] ) {
-            if ( isAlarmActive[4] ) { arrayOfAlarmLEDs[4].on(); }
+            if ( isAlarmActive[AlarmMute] ) { arrayOfAlarmLEDs[AlarmMute].on(); }
             else {arrayOfAlarmLEDs[i].blink(120); } 
             } //  If true blink
         else arrayOfAlarmLEDs[i].off(); //  Otherwise switch off. 
@@ -727,9 +814,11 @@ void DisplayWaterfall(unsigned long TimeForInit) {
     arrayOfSetParameterLEDs[0].on();
     arrayOfModeLEDs[0].off();
     unsigned long timer = millis();
+    watchdog.stage(WaterfallStage);
 
 //  Display Waterfall
     while (millis() - timer < TimeForInit) {
+        watchdog.feed();
         for (TM1637Display Display : arrayOfDisplays) {
             Display.setSegments(hyphens);
         }
@@ -749,36 +838,96 @@ void DisplayWaterfall(unsigned long TimeForInit) {
     arrayOfSetParameterLEDs[counter%NumberOfSetParameters].off();
     arrayOfModeLEDs[counter%NumberOfModeLEDs].off();
     // arrayOfAlarmLEDs[counter%numberOfAlarms].off();
+    watchdog.feed();
     for (int i = 0; i < NumberOfDisplays; i++) {
         arrayOfDisplays[i].clear();
     }
 }
 
+void ReportStalls() {
+    /**
+    * Print the stall record if the last reset was caused by the watchdog,
+    * or if the loop overran its budget but recovered.
+    */
+    bool reset = watchdog.hadStallReset();
+    if (!reset && !watchdog.hadOverrun()) { return; }
+    const StallRecord &stall = watchdog.lastStall();
+    Serial.println();
+    Serial.print(reset? "Watchdog reset: stage = " : "Loop overrun: stage = ");
+    Serial.print(stall.stage);
+    Serial.print(", stage ms = ");
+    Serial.print(stall.stageMillis);
+    Serial.print(", loop ms = ");
+    Serial.print(stall.loopMillis);
+    Serial.print(", heartbeat = ");
+    Serial.print(stall.heartbeat);
+    Serial.println();
+}
+
+void NotifyIfFrameChanged() {
+    /**
+    * Raise the attention line if a setting, mode or the mute flag has changed since the
+    * last notification. It stays raised until the controller reads the frame.
+    * Called with interrupts off, as requestEvent also updates notifiedFrame.
+    */
+    if (memcmp(dataToSend, notifiedFrame, sizeof(notifiedFrame)) != 0) {
+        memcpy(notifiedFrame, dataToSend, sizeof(notifiedFrame));
+        *attentionPort |= attentionMask;
+    }
+}
+
 void requestEvent() {
     /**
     * Send the parameter values when requested.
     */
 
+    unsigned long start = micros();
     uint8_t* dataToSendptr;
     dataToSendptr = dataToSend;  // 
     // Write the values as 8 bit unsigned ( 0 - 255 )
     Wire.write(dataToSendptr, sizeof(dataToSend));
-    // Mute button only survives one request 
-    isButtonClicked[MuteButton] = isButtonPressed[MuteButton] = 0 ; 
-
+    // Mute button only survives one request, once it has actually been sent. 
+    // Its clearing is not a change the controller needs to be told about.
+    if (dataToSend[MuteSlot]) {
+        isButtonClicked[MuteButton] = isButtonPressed[MuteButton] = 0 ; 
+        notifiedFrame[MuteSlot] = 0;
+    }
+    // The controller has the latest frame, so lower the attention line
+    *attentionPort &= ~attentionMask;
+    i2cStats[FramesRequestedStat]++;
+    RecordCallbackTime(start);
 }
 
 void receiveEvent(int numberOfBytes) {
     /**
-    * Read the received bytes from I2C.
+    * Read the received bytes from I2C. A pressure waveform block goes straight to the
+    * waveform ring, and a full readback and alarm frame is copied in. Writes of any other
+    * length are dropped, so a truncated frame cannot leave mixed old and new values.
+    * The alarm LEDs are updated from the loop, to keep this short.
     */
-    unsigned long i = 0;
-    uint8_t* receivedParamValsPtr = (uint8_t*) receivedParameterValues;
-    while (Wire.available() && i < sizeof(receivedParameterValues) ) {
-        *receivedParamValsPtr++ = Wire.read();
-        i++;
+    unsigned long start = micros();
+    if (numberOfBytes == WaveformFrameSize && Wire.peek() == WaveformFrameTag) {
+        Wire.read();
+        i2cStats[pressureWaveform.ingest() ? WaveformBlocksStat : FramesRejectedStat]++;
     }
+    else if (numberOfBytes == sizeof(receivedParameterValues)) {
+        uint8_t* receivedParamValsPtr = (uint8_t*) receivedParameterValues;
+        for (uint8_t i = 0; i < sizeof(receivedParameterValues); i++) {
+            *receivedParamValsPtr++ = Wire.read();
+        }
+        i2cStats[FramesReceivedStat]++;
+    }
+    else {
+        while (Wire.available()) { Wire.read(); }
+        i2cStats[FramesRejectedStat]++;
+    }
+    RecordCallbackTime(start);
+}
 
-    //  Show Ventilator alarms
-    showAlarms();
+void RecordCallbackTime(unsigned long start) {
+    /**
+    * Keep the longest time spent in an I2C callback, for the soak test.
+    */
+    unsigned long elapsed = micros() - start;
+    if (elapsed > i2cStats[WorstCallbackMicrosStat]) { i2cStats[WorstCallbackMicrosStat] = elapsed; }
 }
\ No newline at end of file
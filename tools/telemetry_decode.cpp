@@ -0,0 +1,114 @@
+// Host-side decoder for the UI telemetry stream. Reads COBS-framed records from stdin
+// and prints the full UI state after each record, one line per record. I2C statistics
+// records are printed on their own lines.
+//
+// Build:  g++ -O2 -I.. -o telemetry_decode telemetry_decode.cpp
+// Run:    stty -F /dev/ttyACM0 115200 raw && ./telemetry_decode < /dev/ttyACM0
+
+#include <stdio.h>
+#include <stdint.h>
+#include <UiLayout.h>
+#include <Cobs.h>
+
+#define UI_FIELD_NAME(name, ...) #name,
+static const char *fieldNames[NumberOfTelemetryFields] = {
+    "OperatingMode", "VentilationMode", "AlarmBits",
+    UI_SET_PARAMETERS(UI_FIELD_NAME)
+    UI_READBACKS(UI_FIELD_NAME)
+};
+
+static const char *statNames[NumberOfI2cStats] = {
+    "FramesReceived", "WaveformBlocks", "FramesRejected", "FramesRequested", "WorstCallbackMicros"
+};
+
+static int16_t fields[NumberOfTelemetryFields];
+static bool haveFullRecord = false;
+static unsigned long corruptRecords = 0, missedRecords = 0;
+
+static int16_t readField(const uint8_t *p) {
+    return int16_t(p[0] | (p[1] << 8));
+}
+
+static bool decodeRecord(const uint8_t *record, size_t length) {
+    /* Apply one record to the current state. Returns false if it is corrupt. */
+    if (length < 3) { return false; }
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) { sum += record[i]; }
+    if (sum != 0) { return false; }
+
+    static bool haveSequence = false;
+    static uint8_t lastSequence;
+    uint8_t type = record[0], sequence = record[1];
+    const uint8_t *payload = record + 2;
+    size_t payloadLength = length - 3;
+    uint16_t mask = 0xFFFF;
+    int count = NumberOfTelemetryFields;
+
+    if (type == StatsRecord) {
+        count = NumberOfI2cStats;
+    } else if (type == DeltaRecord) {
+        if (payloadLength < 2) { return false; }
+        mask = payload[0] | (payload[1] << 8);
+        payload += 2;
+        payloadLength -= 2;
+    } else if (type != FullRecord) {
+        return false;
+    }
+    size_t expected = 0;
+    for (int i = 0; i < count; i++) {
+        if (mask & (1 << i)) { expected += 2; }
+    }
+    if (payloadLength != expected) { return false; }
+
+    if (haveSequence && uint8_t(lastSequence + 1) != sequence) { missedRecords += uint8_t(sequence - lastSequence - 1); }
+    haveSequence = true;
+    lastSequence = sequence;
+
+    if (type == StatsRecord) {
+        printf("stats %3u", sequence);
+        for (int i = 0; i < NumberOfI2cStats; i++) {
+            printf(" %s=%u", statNames[i], uint16_t(readField(payload + 2 * i)));
+        }
+        printf("\n");
+        fflush(stdout);
+        return true;
+    }
+
+    for (int i = 0; i < NumberOfTelemetryFields; i++) {
+        if (mask & (1 << i)) {
+            fields[i] = readField(payload);
+            payload += 2;
+        }
+    }
+    if (type == FullRecord) { haveFullRecord = true; }
+
+    /* Delta records before the first full record only carry part of the state. */
+    if (!haveFullRecord) { return true; }
+    printf("%s %3u", type == FullRecord ? "full " : "delta", sequence);
+    for (int i = 0; i < NumberOfTelemetryFields; i++) {
+        printf(" %s=%d%s", fieldNames[i], fields[i], (type == DeltaRecord && (mask & (1 << i))) ? "*" : "");
+    }
+    printf(" missed=%lu corrupt=%lu\n", missedRecords, corruptRecords);
+    fflush(stdout);
+    return true;
+}
+
+int main() {
+    uint8_t frame[256], record[256];
+    size_t frameLength = 0;
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (c != 0) {
+            /* Frames longer than any record are corrupt; drop bytes until the next delimiter. */
+            if (frameLength < sizeof(frame)) { frame[frameLength] = c; }
+            frameLength++;
+            continue;
+        }
+        if (frameLength > 0) {
+            size_t length = frameLength <= sizeof(frame) ? cobsDecode(frame, frameLength, record) : 0;
+            if (!decodeRecord(record, length)) { corruptRecords++; }
+        }
+        frameLength = 0;
+    }
+    return 0;
+}